@@ -0,0 +1,898 @@
+// Microbenchmarks for the core Pokedex / owner-list operations.
+//
+// Build (from the repo root):
+//   gcc -O2 -std=c99 -Wall -Wextra -Werror bench/bench.c -o ex6_bench -pthread
+// Run:
+//   ./ex6_bench [--seed S] [--max-owners N] [--max-link N] [--max-sort N] [--max-similar N] [--threads T]
+//               [--min-ms MS] [--filter TEXT]
+//
+// The bench includes ex6.c directly (with EX6_NO_MAIN) so it drives the real functions, not copies.
+// Everything ex6.c prints goes to /dev/null; the report goes to the original stdout.
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// counting wrappers, installed before ex6.c so every malloc/realloc/free in it is seen
+static unsigned long long benchAllocCount = 0;
+
+static void *benchMalloc(size_t size)
+{
+    benchAllocCount++;
+    return malloc(size);
+}
+
+static void *benchRealloc(void *ptr, size_t size)
+{
+    benchAllocCount++;
+    return realloc(ptr, size);
+}
+
+#define malloc(size) benchMalloc(size)
+#define realloc(ptr, size) benchRealloc(ptr, size)
+
+#define EX6_NO_MAIN
+#include "../ex6.c"
+
+#undef malloc
+#undef realloc
+
+#define MAX_ID 151
+#define NUM_ORDERS 3
+
+typedef enum
+{
+    ORDER_ASCENDING,
+    ORDER_RANDOM,
+    ORDER_ADVERSARIAL
+} IdOrder;
+
+static const char *orderNames[NUM_ORDERS] = {"ascending", "random", "adversarial"};
+
+static FILE *report = NULL;
+static unsigned long long rngState = 0x9E3779B97F4A7C15ULL;
+static double minNs = 50e6; // keep repeating a measurement until it covered this much time
+static const char *filter = NULL;
+
+// --------------------------------------------------------------
+// Helpers
+// --------------------------------------------------------------
+
+static unsigned long long nextRandom(void)
+{
+    // xorshift64*, good enough for shuffles
+    rngState ^= rngState >> 12;
+    rngState ^= rngState << 25;
+    rngState ^= rngState >> 27;
+    return rngState * 2685821657736338717ULL;
+}
+
+static double nowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void shuffleInts(int *arr, int n)
+{
+    for (int i = n - 1; i > 0; i--)
+    {
+        int j = (int)(nextRandom() % (unsigned long long)(i + 1));
+        int tmp = arr[i];
+        arr[i] = arr[j];
+        arr[j] = tmp;
+    }
+}
+
+static void makeOrder(IdOrder order, int *ids)
+{
+    // ascending and adversarial (zig-zag between the extremes) both build a chain of depth n,
+    // random builds the "typical" tree
+    for (int i = 0; i < MAX_ID; i++)
+        ids[i] = i + 1;
+    if (order == ORDER_RANDOM)
+        shuffleInts(ids, MAX_ID);
+    else if (order == ORDER_ADVERSARIAL)
+    {
+        int low = 1, high = MAX_ID;
+        for (int i = 0; i < MAX_ID; i++)
+            ids[i] = (i % 2 == 0) ? low++ : high--;
+    }
+}
+
+static PokemonNode *buildTree(const int *ids, int n)
+{
+    PokemonNode *root = NULL;
+    for (int i = 0; i < n; i++)
+    {
+        root = insertPokemonNode(root, createPokemonNode(pokedex + ids[i] - 1));
+    }
+    return root;
+}
+
+static int wanted(const char *name)
+{
+    return filter == NULL || strstr(name, filter) != NULL;
+}
+
+static void printRow(const char *op, const char *order, long n, double ns, long ops, unsigned long long allocs)
+{
+    fprintf(report, "%-28s %-12s %9ld %14.1f %11.2f\n", op, order, n,
+            ops ? ns / ops : 0.0, ops ? (double)allocs / ops : 0.0);
+    fflush(report);
+}
+
+static void printHeader(const char *title)
+{
+    fprintf(report, "\n# %s\n", title);
+    fprintf(report, "%-28s %-12s %9s %14s %11s\n", "operation", "workload", "n", "ns/op", "allocs/op");
+}
+
+// --------------------------------------------------------------
+// Pokedex tree operations (n <= 151, one tree at a time)
+// --------------------------------------------------------------
+
+static long visitedNodes = 0;
+// results are stored here so the compiler cannot drop or hoist the measured calls
+static PokemonNode *volatile benchSink = NULL;
+
+static void countVisit(PokemonNode *node)
+{
+    (void)node;
+    visitedNodes++;
+}
+
+static void benchInsert(IdOrder order, int n)
+{
+    int ids[MAX_ID];
+    makeOrder(order, ids);
+    double ns = 0;
+    long ops = 0;
+    unsigned long long allocs = 0;
+    while (ns < minNs)
+    {
+        unsigned long long a0 = benchAllocCount;
+        double t0 = nowNs();
+        PokemonNode *root = buildTree(ids, n);
+        ns += nowNs() - t0;
+        allocs += benchAllocCount - a0;
+        ops += n;
+        freePokemonTree(root);
+    }
+    printRow("insertPokemonNode", orderNames[order], n, ns, ops, allocs);
+}
+
+static void benchSearch(IdOrder order, int n)
+{
+    int ids[MAX_ID];
+    makeOrder(order, ids);
+    PokemonNode *volatile root = buildTree(ids, n);
+    double ns = 0;
+    long ops = 0;
+    unsigned long long a0 = benchAllocCount;
+    while (ns < minNs)
+    {
+        double t0 = nowNs();
+        // every catalog ID, so both hits and misses are in the mix
+        for (int id = 1; id <= MAX_ID; id++)
+            benchSink = searchPokemonBFS(root, id);
+        ns += nowNs() - t0;
+        ops += MAX_ID;
+    }
+    printRow("searchPokemonBFS", orderNames[order], n, ns, ops, benchAllocCount - a0);
+    freePokemonTree(root);
+}
+
+static void benchFrozenSearch(IdOrder order, int n)
+{
+    // the search row again after freezePokedex (which rebuilds the tree as a complete tree)
+    int ids[MAX_ID];
+    makeOrder(order, ids);
+    OwnerNode *owner = createOwner("bench", buildTree(ids, n));
+    freezePokedex(owner);
+    double ns = 0;
+    long ops = 0;
+    unsigned long long a0 = benchAllocCount;
+    while (ns < minNs)
+    {
+        double t0 = nowNs();
+        for (int id = 1; id <= MAX_ID; id++)
+            benchSink = findPokemon(owner, id);
+        ns += nowNs() - t0;
+        ops += MAX_ID;
+    }
+    printRow("findPokemon (frozen)", orderNames[order], n, ns, ops, benchAllocCount - a0);
+    freeOwnerNode(owner);
+}
+
+static void benchRemove(IdOrder order, int n)
+{
+    int ids[MAX_ID];
+    int removeOrder[MAX_ID];
+    makeOrder(order, ids);
+    double ns = 0;
+    long ops = 0;
+    unsigned long long allocs = 0;
+    while (ns < minNs)
+    {
+        PokemonNode *root = buildTree(ids, n);
+        memcpy(removeOrder, ids, sizeof(int) * n);
+        shuffleInts(removeOrder, n);
+        unsigned long long a0 = benchAllocCount;
+        double t0 = nowNs();
+        for (int i = 0; i < n; i++)
+            root = removePokemonByID(root, removeOrder[i]);
+        ns += nowNs() - t0;
+        allocs += benchAllocCount - a0;
+        ops += n;
+        freePokemonTree(root);
+    }
+    printRow("removePokemonByID", orderNames[order], n, ns, ops, allocs);
+}
+
+typedef void (*TraversalFunc)(PokemonNode *, VisitNodeFunc);
+
+static void benchTraversal(const char *name, TraversalFunc traversal, IdOrder order, int n)
+{
+    int ids[MAX_ID];
+    makeOrder(order, ids);
+    PokemonNode *root = buildTree(ids, n);
+    double ns = 0;
+    unsigned long long a0 = benchAllocCount;
+    visitedNodes = 0;
+    while (ns < minNs)
+    {
+        double t0 = nowNs();
+        traversal(root, countVisit);
+        ns += nowNs() - t0;
+    }
+    // ns/op here is per visited node
+    printRow(name, orderNames[order], n, ns, visitedNodes, benchAllocCount - a0);
+    freePokemonTree(root);
+}
+
+static void benchAlphabetical(IdOrder order, int n)
+{
+    int ids[MAX_ID];
+    makeOrder(order, ids);
+    PokemonNode *root = buildTree(ids, n);
+    double ns = 0;
+    long ops = 0;
+    unsigned long long a0 = benchAllocCount;
+    while (ns < minNs)
+    {
+        double t0 = nowNs();
+        displayAlphabetical(root);
+        ns += nowNs() - t0;
+        ops++;
+    }
+    printRow("displayAlphabetical", orderNames[order], n, ns, ops, benchAllocCount - a0);
+    freePokemonTree(root);
+}
+
+static void benchMerge(IdOrder order, int n)
+{
+    // source holds the odd IDs, destination the even ones, so every source node gets copied
+    int ids[MAX_ID];
+    int odd[MAX_ID], even[MAX_ID];
+    int oddCount = 0, evenCount = 0;
+    makeOrder(order, ids);
+    for (int i = 0; i < n; i++)
+    {
+        if (ids[i] % 2)
+            odd[oddCount++] = ids[i];
+        else
+            even[evenCount++] = ids[i];
+    }
+    if (oddCount == 0 || evenCount == 0)
+        return;
+    double ns = 0;
+    long ops = 0;
+    unsigned long long allocs = 0;
+    while (ns < minNs)
+    {
+        PokemonNode *source = buildTree(odd, oddCount);
+        PokemonNode *dest = buildTree(even, evenCount);
+        unsigned long long a0 = benchAllocCount;
+        double t0 = nowNs();
+        dest = BFSMerge(source, dest);
+        ns += nowNs() - t0;
+        allocs += benchAllocCount - a0;
+        ops++;
+        freePokemonTree(source);
+        freePokemonTree(dest);
+    }
+    printRow("BFSMerge", orderNames[order], n, ns, ops, allocs);
+}
+
+static void benchCloneRemove(IdOrder order, int n)
+{
+    // clone the tree, release one Pokemon from the clone, drop the clone: allocs/op is the copied path
+    int ids[MAX_ID];
+    makeOrder(order, ids);
+    PokemonNode *root = buildTree(ids, n);
+    double ns = 0;
+    long ops = 0;
+    unsigned long long a0 = benchAllocCount;
+    while (ns < minNs)
+    {
+        double t0 = nowNs();
+        for (int i = 0; i < n; i++)
+        {
+            PokemonNode *clone = retainPokemonTree(root);
+            clone = removePokemonByID(clone, ids[i]);
+            freePokemonTree(clone);
+        }
+        ns += nowNs() - t0;
+        ops += n;
+    }
+    printRow("clone+removePokemonByID", orderNames[order], n, ns, ops, benchAllocCount - a0);
+    freePokemonTree(root);
+}
+
+static int compactVisited = 0;
+
+static void countCompactVisit(const PokemonData *data)
+{
+    (void)data;
+    compactVisited++;
+}
+
+static void benchCompact(IdOrder order, int n)
+{
+    // the insert, search and in-order rows again, on the index-based layout
+    int ids[MAX_ID];
+    makeOrder(order, ids);
+    double ns = 0;
+    long ops = 0;
+    unsigned long long allocs = 0;
+    CompactPokedex dex;
+    while (ns < minNs)
+    {
+        compactInit(&dex);
+        unsigned long long a0 = benchAllocCount;
+        double t0 = nowNs();
+        for (int i = 0; i < n; i++)
+            compactInsert(&dex, ids[i]);
+        ns += nowNs() - t0;
+        allocs += benchAllocCount - a0;
+        ops += n;
+        compactFree(&dex);
+    }
+    printRow("compactInsert", orderNames[order], n, ns, ops, allocs);
+
+    compactInit(&dex);
+    for (int i = 0; i < n; i++)
+        compactInsert(&dex, ids[i]);
+    volatile int found = 0;
+    ns = 0;
+    ops = 0;
+    unsigned long long a0 = benchAllocCount;
+    while (ns < minNs)
+    {
+        double t0 = nowNs();
+        for (int id = 1; id <= MAX_ID; id++)
+            found += compactContains(&dex, id);
+        ns += nowNs() - t0;
+        ops += MAX_ID;
+    }
+    printRow("compactContains", orderNames[order], n, ns, ops, benchAllocCount - a0);
+
+    ns = 0;
+    ops = 0;
+    a0 = benchAllocCount;
+    while (ns < minNs)
+    {
+        compactVisited = 0;
+        double t0 = nowNs();
+        compactInOrder(&dex, countCompactVisit);
+        ns += nowNs() - t0;
+        ops += compactVisited;
+    }
+    printRow("compactInOrder", orderNames[order], n, ns, ops, benchAllocCount - a0);
+    compactFree(&dex);
+}
+
+static void benchBulkAdd(IdOrder order, int n)
+{
+    // the same IDs as the insert row, in one addPokemonBulk call into an empty Pokedex (undo record included)
+    int ids[MAX_ID];
+    makeOrder(order, ids);
+    OwnerNode *owner = createOwner("bench", NULL);
+    double ns = 0;
+    long ops = 0;
+    unsigned long long allocs = 0;
+    while (ns < minNs)
+    {
+        unsigned long long a0 = benchAllocCount;
+        double t0 = nowNs();
+        addPokemonBulk(owner, ids, n);
+        ns += nowNs() - t0;
+        allocs += benchAllocCount - a0;
+        ops += n;
+        clearUndoHistory();
+        freePokemonTree(owner->pokedexRoot);
+        owner->pokedexRoot = NULL;
+    }
+    printRow("addPokemonBulk", orderNames[order], n, ns, ops, allocs);
+    EX6_FREE(owner);
+}
+
+// --------------------------------------------------------------
+// Owner list operations (10 .. 10^6 owners)
+// --------------------------------------------------------------
+
+static char **ownerNames = NULL;
+
+static void appendOwnerFast(OwnerNode *owner)
+{
+    // O(1) append before the head; linkOwnerInCircularList walks the whole ring and is measured separately
+    if (ownerHead == NULL)
+    {
+        ownerHead = owner;
+        owner->next = owner;
+        owner->prev = owner;
+        return;
+    }
+    OwnerNode *tail = ownerHead->prev;
+    owner->next = ownerHead;
+    owner->prev = tail;
+    tail->next = owner;
+    ownerHead->prev = owner;
+}
+
+static void makeOwnerNames(int n)
+{
+    // unique names in a shuffled order so sorting has real work to do
+    int *perm = malloc(sizeof(int) * n);
+    ownerNames = malloc(sizeof(char *) * n);
+    if (!perm || !ownerNames)
+        exit(1);
+    for (int i = 0; i < n; i++)
+        perm[i] = i;
+    shuffleInts(perm, n);
+    for (int i = 0; i < n; i++)
+    {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "Trainer%07d", perm[i]);
+        ownerNames[i] = myStrdup(buffer);
+    }
+    free(perm);
+}
+
+static void freeOwnerNames(int n)
+{
+    // the names come from myStrdup, so they go back through ex6's allocator
+    for (int i = 0; i < n; i++)
+        EX6_FREE(ownerNames[i]);
+    free(ownerNames);
+    ownerNames = NULL;
+}
+
+static void buildOwners(int n)
+{
+    for (int i = 0; i < n; i++)
+        appendOwnerFast(createOwner(ownerNames[i], createPokemonNode(pokedex + (i % 3) * 3)));
+}
+
+static void benchFindOwner(int n)
+{
+    makeOwnerNames(n);
+    buildOwners(n);
+    double ns = 0;
+    long ops = 0;
+    unsigned long long a0 = benchAllocCount;
+    while (ns < minNs)
+    {
+        const char *name = ownerNames[nextRandom() % (unsigned long long)n];
+        double t0 = nowNs();
+        if (findOwnerByName(name) == NULL)
+            fprintf(report, "lookup miss for %s\n", name);
+        ns += nowNs() - t0;
+        ops++;
+    }
+    printRow("findOwnerByName", "random-hit", n, ns, ops, benchAllocCount - a0);
+    freeAllOwners();
+    freeOwnerNames(n);
+}
+
+static void benchLinkOwner(int n)
+{
+    makeOwnerNames(n);
+    double ns = 0;
+    long ops = 0;
+    unsigned long long allocs = 0;
+    while (ns < minNs)
+    {
+        double t0 = nowNs();
+        unsigned long long a0 = benchAllocCount;
+        for (int i = 0; i < n; i++)
+            linkOwnerInCircularList(createOwner(ownerNames[i], NULL));
+        allocs += benchAllocCount - a0;
+        ns += nowNs() - t0;
+        ops += n;
+        freeAllOwners();
+    }
+    printRow("linkOwnerInCircularList", "append", n, ns, ops, allocs);
+    freeOwnerNames(n);
+}
+
+static void benchSortOwners(int n)
+{
+    makeOwnerNames(n);
+    double ns = 0;
+    long ops = 0;
+    unsigned long long allocs = 0;
+    while (ns < minNs)
+    {
+        buildOwners(n);
+        unsigned long long a0 = benchAllocCount;
+        double t0 = nowNs();
+        sortOwners();
+        ns += nowNs() - t0;
+        allocs += benchAllocCount - a0;
+        ops++;
+        freeAllOwners();
+    }
+    printRow("sortOwners", "shuffled", n, ns, ops, allocs);
+    freeOwnerNames(n);
+}
+
+static void benchCircularPrint(int n, int lines)
+{
+    // ten passes around the ring (at least 10^5 lines), or a fixed short print, into a /dev/null stream;
+    // ns/op is per line
+    makeOwnerNames(n);
+    buildOwners(n);
+    FILE *sink = fopen("/dev/null", "w");
+    int count = lines > 0 ? lines : (n * 10 < 100000 ? 100000 : n * 10);
+    double ns = 0;
+    long ops = 0;
+    unsigned long long allocs = 0;
+    while (ns < minNs)
+    {
+        unsigned long long a0 = benchAllocCount;
+        double t0 = nowNs();
+        writeOwnersCircular(sink, 1, count);
+        fflush(sink);
+        ns += nowNs() - t0;
+        allocs += benchAllocCount - a0;
+        ops += count;
+    }
+    printRow("writeOwnersCircular", lines > 0 ? "3 lines" : "forward", n, ns, ops, allocs);
+    fclose(sink);
+    freeAllOwners();
+    freeOwnerNames(n);
+}
+
+static void benchExport(int n, ExportFormat format)
+{
+    // the whole ring (one Pokemon per owner) into a /dev/null stream; ns/op is per row
+    makeOwnerNames(n);
+    buildOwners(n);
+    FILE *sink = fopen("/dev/null", "w");
+    double ns = 0;
+    long ops = 0;
+    unsigned long long allocs = 0;
+    while (ns < minNs)
+    {
+        unsigned long long a0 = benchAllocCount;
+        double t0 = nowNs();
+        ops += exportRegistry(sink, format);
+        fflush(sink);
+        ns += nowNs() - t0;
+        allocs += benchAllocCount - a0;
+    }
+    printRow("exportRegistry", format == EXPORT_CSV ? "csv" : "jsonl", n, ns, ops, allocs);
+    fclose(sink);
+    freeAllOwners();
+    freeOwnerNames(n);
+}
+
+static void benchBatch(int n)
+{
+    // 8 adds per owner queued round-robin across the ring and committed, then the same as releases; ns/op is per
+    // queued operation, commit included
+    makeOwnerNames(n);
+    buildOwners(n);
+    OwnerNode **owners = malloc((size_t)n * sizeof(OwnerNode *));
+    OwnerNode *owner = ownerHead;
+    for (int i = 0; i < n; i++, owner = owner->next)
+        owners[i] = owner;
+    CommandBatch batch;
+    batchInit(&batch);
+    double ns = 0;
+    long ops = 0;
+    unsigned long long allocs = 0;
+    for (int round = 0; ns < minNs; round++)
+    {
+        unsigned long long a0 = benchAllocCount;
+        double t0 = nowNs();
+        for (int id = 20; id < 28; id++)
+            for (int i = 0; i < n; i++)
+                batchQueue(&batch, owners[i], round % 2 ? BATCH_RELEASE : BATCH_ADD, id, 0);
+        if (batchCommit(&batch) < 0)
+            fprintf(report, "batch rejected\n");
+        ns += nowNs() - t0;
+        allocs += benchAllocCount - a0;
+        ops += 8L * n;
+    }
+    printRow("batchCommit", "add/release", n, ns, ops, allocs);
+    clearUndoHistory();
+    free(owners);
+    freeAllOwners();
+    freeOwnerNames(n);
+}
+
+static void benchSimilarity(int n, int threads)
+{
+    // random collections of about a third of the species, top 10 neighbours each; ns/op is per pair
+    SpeciesSet *sets = malloc((size_t)n * sizeof(SpeciesSet));
+    SimilarityNeighbor *neighbors = malloc((size_t)n * 10 * sizeof(SimilarityNeighbor));
+    for (int i = 0; i < n; i++)
+    {
+        sets[i].bits[0] = nextRandom() & nextRandom();
+        sets[i].bits[1] = nextRandom() & nextRandom();
+        sets[i].bits[2] = nextRandom() & nextRandom() & ((1ULL << (MAX_ID - 128)) - 1);
+    }
+    double ns = 0;
+    long ops = 0;
+    unsigned long long allocs = 0;
+    while (ns < minNs)
+    {
+        unsigned long long a0 = benchAllocCount;
+        double t0 = nowNs();
+        similarityTopK(sets, n, 10, threads, neighbors);
+        ns += nowNs() - t0;
+        allocs += benchAllocCount - a0;
+        ops += (long)n * (n - 1);
+    }
+    char workload[32];
+    snprintf(workload, sizeof(workload), "top10-%dt", threads);
+    printRow("similarityTopK", workload, n, ns, ops, allocs);
+    free(neighbors);
+    free(sets);
+}
+
+static void benchSimilarityMatrix(int n, int threads)
+{
+    // the compute half of writeSimilarityMatrix: two blocks of rows on one persistent pool, nothing written; ns/op is per pair
+    SpeciesSet *sets = malloc((size_t)n * sizeof(SpeciesSet));
+    for (int i = 0; i < n; i++)
+    {
+        sets[i].bits[0] = nextRandom() & nextRandom();
+        sets[i].bits[1] = nextRandom() & nextRandom();
+        sets[i].bits[2] = nextRandom() & nextRandom() & ((1ULL << (MAX_ID - 128)) - 1);
+    }
+    int blockRows = similarityBlockRows(n, threads);
+    int blocks = 2 * blockRows <= n ? 2 : 1;
+    SimilarityJob job = {.sets = sets, .n = n};
+    job.counts = speciesCounts(sets, n);
+    job.block = EX6_MALLOC(ALLOC_INDEX, (size_t)blockRows * n * sizeof(float));
+    double ns = 0;
+    long ops = 0;
+    unsigned long long allocs = 0;
+    while (ns < minNs)
+    {
+        unsigned long long a0 = benchAllocCount;
+        double t0 = nowNs();
+        startSimilarityPool(&job, threads);
+        for (int b = 0; b < blocks; b++)
+            runSimilarityBlock(&job, b * blockRows, (b + 1) * blockRows < n ? (b + 1) * blockRows : n);
+        stopSimilarityPool(&job);
+        ns += nowNs() - t0;
+        allocs += benchAllocCount - a0;
+        ops += (long)blocks * blockRows * n;
+    }
+    char workload[32];
+    snprintf(workload, sizeof(workload), "matrix-%dt", threads);
+    printRow("writeSimilarityMatrix", workload, n, ns, ops, allocs);
+    EX6_FREE(job.block);
+    EX6_FREE((void *)job.counts);
+    free(sets);
+}
+
+// --------------------------------------------------------------
+// Driver
+// --------------------------------------------------------------
+
+static long parseLongArg(const char *value, const char *flag)
+{
+    char *end;
+    long result = strtol(value, &end, 10);
+    if (*end != '\0' || result < 0)
+    {
+        fprintf(stderr, "Invalid value for %s: %s\n", flag, value);
+        exit(2);
+    }
+    return result;
+}
+
+static void benchBattle(int threads)
+{
+    // a Charizard mirror match, an even fight of about nine rounds; ns/op is per battle
+    BattleOdds odds;
+    long battles = 4L * BATTLE_CHUNK * threads;
+    double ns = 0;
+    long ops = 0;
+    unsigned long long allocs = 0;
+    while (ns < minNs)
+    {
+        unsigned long long a0 = benchAllocCount;
+        double t0 = nowNs();
+        battleOdds(&pokedex[5], &pokedex[5], battles, (uint64_t)ops, threads, &odds);
+        ns += nowNs() - t0;
+        allocs += benchAllocCount - a0;
+        ops += battles;
+    }
+    char workload[32];
+    snprintf(workload, sizeof(workload), "%dt", threads);
+    printRow("battleOdds", workload, 1, ns, ops, allocs);
+}
+
+static void benchLineup(int threads)
+{
+    // every species against every species, 100 battles per matchup; ns/op is per matchup (simulation and assignment)
+    const PokemonData *all[MAX_ID];
+    for (int i = 0; i < MAX_ID; i++)
+        all[i] = &pokedex[i];
+    OwnerNode *team = createOwner("team", buildBalancedPokedex(NULL, all, MAX_ID));
+    LineupPair pairs[MAX_ID];
+    double ns = 0;
+    long ops = 0;
+    unsigned long long allocs = 0;
+    while (ns < minNs)
+    {
+        unsigned long long a0 = benchAllocCount;
+        double t0 = nowNs();
+        optimizeLineup(team, team, 100, (uint64_t)ops, threads, pairs);
+        ns += nowNs() - t0;
+        allocs += benchAllocCount - a0;
+        ops += (long)MAX_ID * MAX_ID;
+    }
+    char workload[32];
+    snprintf(workload, sizeof(workload), "%dt", threads);
+    printRow("optimizeLineup", workload, MAX_ID, ns, ops, allocs);
+    freeOwnerNode(team);
+}
+
+int main(int argc, char **argv)
+{
+    long maxOwners = 1000000;
+    long maxLink = 10000;
+    long maxSort = 10000;
+    long maxSimilar = 10000;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN) > 0 ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+    unsigned long long seed = 12345;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+        {
+            fprintf(stderr, "Missing value for %s\n", argv[i]);
+            return 2;
+        }
+        if (strcmp(argv[i], "--seed") == 0)
+            seed = (unsigned long long)parseLongArg(argv[++i], "--seed");
+        else if (strcmp(argv[i], "--max-owners") == 0)
+            maxOwners = parseLongArg(argv[++i], "--max-owners");
+        else if (strcmp(argv[i], "--max-link") == 0)
+            maxLink = parseLongArg(argv[++i], "--max-link");
+        else if (strcmp(argv[i], "--max-sort") == 0)
+            maxSort = parseLongArg(argv[++i], "--max-sort");
+        else if (strcmp(argv[i], "--max-similar") == 0)
+            maxSimilar = parseLongArg(argv[++i], "--max-similar");
+        else if (strcmp(argv[i], "--threads") == 0)
+            threads = parseLongArg(argv[++i], "--threads");
+        else if (strcmp(argv[i], "--min-ms") == 0)
+            minNs = parseLongArg(argv[++i], "--min-ms") * 1e6;
+        else if (strcmp(argv[i], "--filter") == 0)
+            filter = argv[++i];
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    rngState ^= seed * 0xBF58476D1CE4E5B9ULL;
+    if (rngState == 0)
+        rngState = 1;
+
+    // keep the real stdout for the report, silence everything ex6.c prints
+    report = fdopen(dup(STDOUT_FILENO), "w");
+    if (!report || !freopen("/dev/null", "w", stdout))
+    {
+        fprintf(stderr, "Cannot redirect stdout.\n");
+        return 1;
+    }
+
+    fprintf(report, "# ex6 microbenchmarks (seed %llu, min %.0f ms per row)\n", seed, minNs / 1e6);
+
+    static const int treeSizes[] = {16, 64, MAX_ID};
+    int numSizes = (int)(sizeof(treeSizes) / sizeof(treeSizes[0]));
+
+    printHeader("Pokedex trees (ns/op per node for inserts, lookups, removals and visits)");
+    for (int order = 0; order < NUM_ORDERS; order++)
+    {
+        for (int s = 0; s < numSizes; s++)
+        {
+            int n = treeSizes[s];
+            if (wanted("insertPokemonNode"))
+                benchInsert((IdOrder)order, n);
+            if (wanted("searchPokemonBFS"))
+                benchSearch((IdOrder)order, n);
+            if (wanted("findPokemon (frozen)"))
+                benchFrozenSearch((IdOrder)order, n);
+            if (wanted("removePokemonByID"))
+                benchRemove((IdOrder)order, n);
+            if (wanted("BFSGeneric"))
+                benchTraversal("BFSGeneric", BFSGeneric, (IdOrder)order, n);
+            if (wanted("preOrderGeneric"))
+                benchTraversal("preOrderGeneric", preOrderGeneric, (IdOrder)order, n);
+            if (wanted("inOrderGeneric"))
+                benchTraversal("inOrderGeneric", inOrderGeneric, (IdOrder)order, n);
+            if (wanted("postOrderGeneric"))
+                benchTraversal("postOrderGeneric", postOrderGeneric, (IdOrder)order, n);
+            if (wanted("displayAlphabetical"))
+                benchAlphabetical((IdOrder)order, n);
+            if (wanted("BFSMerge"))
+                benchMerge((IdOrder)order, n);
+            if (wanted("clone+removePokemonByID"))
+                benchCloneRemove((IdOrder)order, n);
+            if (wanted("addPokemonBulk"))
+                benchBulkAdd((IdOrder)order, n);
+            if (wanted("compact"))
+                benchCompact((IdOrder)order, n);
+        }
+    }
+
+    printHeader("Owner ring scaling (ns/op per lookup, per append, per full sort, per printed line, per exported row, per batched operation, per similarity pair)");
+    for (long n = 10; n <= maxOwners; n *= 10)
+    {
+        if (wanted("findOwnerByName"))
+            benchFindOwner((int)n);
+        if (n <= maxLink && wanted("linkOwnerInCircularList"))
+            benchLinkOwner((int)n);
+        // sortOwners is a bubble sort, so it is capped separately
+        if (n <= maxSort && wanted("sortOwners"))
+            benchSortOwners((int)n);
+        if (wanted("writeOwnersCircular"))
+        {
+            benchCircularPrint((int)n, 0);
+            benchCircularPrint((int)n, 3);
+        }
+        if (wanted("exportRegistry"))
+        {
+            benchExport((int)n, EXPORT_JSONL);
+            benchExport((int)n, EXPORT_CSV);
+        }
+        if (n <= maxLink && wanted("batchCommit"))
+            benchBatch((int)n);
+        // all pairs, so it is capped separately too
+        if (n <= maxSimilar && wanted("similarityTopK"))
+            benchSimilarity((int)n, threads > 0 ? (int)threads : 1);
+        // a fixed two blocks per size, so this one runs at every size, 10^5 owners and up included
+        if (wanted("writeSimilarityMatrix"))
+            benchSimilarityMatrix((int)n, threads > 0 ? (int)threads : 1);
+    }
+
+    printHeader("Battle simulation (ns/op per battle, per lineup matchup)");
+    if (wanted("battleOdds"))
+    {
+        benchBattle(1);
+        if (threads > 1)
+            benchBattle((int)threads);
+    }
+    if (wanted("optimizeLineup"))
+    {
+        benchLineup(1);
+        if (threads > 1)
+            benchLineup((int)threads);
+    }
+
+    fclose(report);
+    return 0;
+}
@@ -0,0 +1,387 @@
+// Synthetic session generator: writes a menu-driven stdin script like input.txt / inputsss.txt.
+//
+// Build (from the repo root):
+//   gcc -O2 -std=c99 -Wall -Wextra -Werror bench/gen_workload.c -o ex6_gen
+// Run:
+//   ./ex6_gen [--owners N] [--ops M] [--seed S] [--mix add=30,release=10,...] > session.txt
+//
+// --owners trainers are created up front, then --ops top-level operations follow; an owner
+// operation enters one Pokedex and runs one to five add/release/evolve/fight/display steps.
+// The generator keeps its own model of the owner ring and every Pokedex, so the script only
+// answers the prompts the program will really ask (empty Pokedexes skip the ID prompt, merges
+// only name existing owners, and so on). Mix keys: add, release, evolve, fight, display,
+// merge, sort, print, delete, new.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../ex6.h"
+
+#define MAX_ID 151
+#define MAX_NAME 32
+
+typedef enum
+{
+    OP_ADD,
+    OP_RELEASE,
+    OP_EVOLVE,
+    OP_FIGHT,
+    OP_DISPLAY,
+    OP_MERGE,
+    OP_SORT,
+    OP_PRINT,
+    OP_DELETE,
+    OP_NEW,
+    NUM_OPS
+} GenOp;
+
+static const char *opNames[NUM_OPS] = {"add", "release", "evolve", "fight", "display",
+                                       "merge", "sort", "print", "delete", "new"};
+static int opWeights[NUM_OPS] = {30, 10, 10, 20, 8, 2, 1, 2, 1, 3};
+
+typedef struct
+{
+    char name[MAX_NAME];
+    unsigned char has[MAX_ID + 1]; // has[id] != 0 if the Pokedex holds that species
+    int count;
+} GenOwner;
+
+static GenOwner *owners = NULL; // in ring order, owners[0] is the head
+static int ownerCount = 0;
+static int ownerCapacity = 0;
+static long nameSerial = 0;
+static unsigned long long rngState = 0x9E3779B97F4A7C15ULL;
+
+static const char *firstNames[] = {"Ash", "Misty", "Brock", "Gary", "Jessie", "James", "Tracey", "May",
+                                   "Max", "Dawn", "Iris", "Cilan", "Serena", "Clemont", "Bonnie", "Lillie",
+                                   "Kiawe", "Lana", "Mallow", "Sophocles", "Goh", "Chloe", "Erika", "Sabrina",
+                                   "Koga", "Blaine", "Giovanni", "Lorelei", "Bruno", "Agatha", "Lance", "Eliyahu",
+                                   "Keren", "Officer Jenny", "Nurse Joy", "Professor Oak"};
+
+static unsigned long long nextRandom(void)
+{
+    rngState ^= rngState >> 12;
+    rngState ^= rngState << 25;
+    rngState ^= rngState >> 27;
+    return rngState * 2685821657736338717ULL;
+}
+
+static int randomBelow(int n)
+{
+    return (int)(nextRandom() % (unsigned long long)n);
+}
+
+// --------------------------------------------------------------
+// Model of the owner ring
+// --------------------------------------------------------------
+
+static int findModelOwner(const char *name)
+{
+    for (int i = 0; i < ownerCount; i++)
+        if (strcmp(owners[i].name, name) == 0)
+            return i;
+    return -1;
+}
+
+static void addModelOwner(const char *name, int starterId)
+{
+    if (ownerCount == ownerCapacity)
+    {
+        ownerCapacity = ownerCapacity ? ownerCapacity * 2 : 64;
+        owners = realloc(owners, sizeof(GenOwner) * ownerCapacity);
+        if (!owners)
+            exit(1);
+    }
+    GenOwner *owner = &owners[ownerCount++];
+    memset(owner, 0, sizeof(GenOwner));
+    strcpy(owner->name, name);
+    owner->has[starterId] = 1;
+    owner->count = 1;
+}
+
+static void removeModelOwner(int index)
+{
+    memmove(&owners[index], &owners[index + 1], sizeof(GenOwner) * (ownerCount - index - 1));
+    ownerCount--;
+}
+
+static int compareModelOwners(const void *a, const void *b)
+{
+    return strcmp(((const GenOwner *)a)->name, ((const GenOwner *)b)->name);
+}
+
+static int randomHeldId(const GenOwner *owner)
+{
+    // picks one of the held species uniformly
+    int skip = randomBelow(owner->count);
+    for (int id = 1; id <= MAX_ID; id++)
+        if (owner->has[id] && skip-- == 0)
+            return id;
+    return 1;
+}
+
+static void makeName(char *out)
+{
+    const char *base = firstNames[randomBelow((int)(sizeof(firstNames) / sizeof(firstNames[0])))];
+    // the first few trainers keep their plain names, later ones get a serial to stay unique
+    snprintf(out, MAX_NAME, "%s", base);
+    if (findModelOwner(out) >= 0)
+        snprintf(out, MAX_NAME, "%s %ld", base, ++nameSerial);
+}
+
+// --------------------------------------------------------------
+// Script emitters, one per menu operation
+// --------------------------------------------------------------
+
+static void emitNewOwner(void)
+{
+    char name[MAX_NAME];
+    makeName(name);
+    int starter = randomBelow(3) + 1;
+    printf("1\n%s\n%d\n", name, starter);
+    addModelOwner(name, (starter - 1) * 3 + 1);
+}
+
+static void emitOwnerOp(GenOp op, GenOwner *owner)
+{
+    switch (op)
+    {
+    case OP_ADD:
+    {
+        // mostly new species, sometimes a duplicate on purpose
+        int id = randomBelow(MAX_ID) + 1;
+        if (owner->count > 0 && randomBelow(10) == 0)
+            id = randomHeldId(owner);
+        printf("1\n%d\n", id);
+        if (!owner->has[id])
+        {
+            owner->has[id] = 1;
+            owner->count++;
+        }
+        break;
+    }
+    case OP_DISPLAY:
+        printf("2\n");
+        if (owner->count > 0)
+            printf("%d\n", randomBelow(5) + 1);
+        break;
+    case OP_RELEASE:
+        printf("3\n");
+        if (owner->count > 0)
+        {
+            int id = randomHeldId(owner);
+            printf("%d\n", id);
+            owner->has[id] = 0;
+            owner->count--;
+        }
+        break;
+    case OP_FIGHT:
+        printf("4\n");
+        if (owner->count > 0)
+            printf("%d\n%d\n", randomHeldId(owner), randomHeldId(owner));
+        break;
+    case OP_EVOLVE:
+        printf("5\n");
+        if (owner->count > 0)
+        {
+            int id = randomHeldId(owner);
+            printf("%d\n", id);
+            if (pokedex[id - 1].CAN_EVOLVE == CAN_EVOLVE)
+            {
+                // same rule as evolvePokemon: an existing evolution means the old one is released
+                owner->has[id] = 0;
+                if (owner->has[id + 1])
+                    owner->count--;
+                else
+                    owner->has[id + 1] = 1;
+            }
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void emitOwnerSession(void)
+{
+    // enter one Pokedex and run a few owner operations in it, like a real user would
+    int index = randomBelow(ownerCount);
+    GenOwner *owner = &owners[index];
+    printf("2\n%d\n", index + 1);
+    int steps = 1 + randomBelow(5);
+    int ownerWeight = 0;
+    for (int op = OP_ADD; op <= OP_DISPLAY; op++)
+        ownerWeight += opWeights[op];
+    for (int i = 0; i < steps; i++)
+    {
+        int pick = randomBelow(ownerWeight);
+        int op = OP_ADD;
+        while (pick >= opWeights[op])
+            pick -= opWeights[op++];
+        emitOwnerOp((GenOp)op, owner);
+    }
+    printf("6\n");
+}
+
+static int emitMerge(void)
+{
+    // merging needs two different owners with non-empty Pokedexes
+    if (ownerCount < 2)
+        return 0;
+    int first = randomBelow(ownerCount);
+    int second = randomBelow(ownerCount - 1);
+    if (second >= first)
+        second++;
+    if (owners[first].count == 0 || owners[second].count == 0)
+        return 0;
+    printf("4\n%s\n%s\n", owners[first].name, owners[second].name);
+    for (int id = 1; id <= MAX_ID; id++)
+    {
+        if (owners[second].has[id] && !owners[first].has[id])
+        {
+            owners[first].has[id] = 1;
+            owners[first].count++;
+        }
+    }
+    removeModelOwner(second);
+    return 1;
+}
+
+static void emitSort(void)
+{
+    printf("5\n");
+    // names are unique, so this matches the program's bubble sort exactly
+    qsort(owners, ownerCount, sizeof(GenOwner), compareModelOwners);
+}
+
+static void emitPrint(void)
+{
+    printf("6\n");
+    if (ownerCount == 0)
+        return;
+    const char *directions[] = {"F", "B", "f", "b"};
+    printf("%s\n%d\n", directions[randomBelow(4)], 1 + randomBelow(ownerCount * 2));
+}
+
+static void emitDelete(void)
+{
+    printf("3\n");
+    if (ownerCount == 0)
+        return;
+    int index = randomBelow(ownerCount);
+    printf("%d\n", index + 1);
+    removeModelOwner(index);
+}
+
+// --------------------------------------------------------------
+// Driver
+// --------------------------------------------------------------
+
+static void parseMix(const char *mix)
+{
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "%s", mix);
+    for (char *item = strtok(buffer, ","); item; item = strtok(NULL, ","))
+    {
+        char *eq = strchr(item, '=');
+        int found = 0;
+        if (eq)
+        {
+            *eq = '\0';
+            for (int op = 0; op < NUM_OPS; op++)
+            {
+                if (strcmp(item, opNames[op]) == 0)
+                {
+                    opWeights[op] = atoi(eq + 1);
+                    found = 1;
+                }
+            }
+        }
+        if (!found)
+        {
+            fprintf(stderr, "Bad --mix entry: %s\n", item);
+            exit(2);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    long initialOwners = 20;
+    long numOps = 1000;
+    unsigned long long seed = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+        {
+            fprintf(stderr, "Missing value for %s\n", argv[i]);
+            return 2;
+        }
+        if (strcmp(argv[i], "--owners") == 0)
+            initialOwners = atol(argv[++i]);
+        else if (strcmp(argv[i], "--ops") == 0)
+            numOps = atol(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0)
+            seed = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--mix") == 0)
+            parseMix(argv[++i]);
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    rngState ^= seed * 0xBF58476D1CE4E5B9ULL;
+    if (rngState == 0)
+        rngState = 1;
+
+    int totalWeight = 0;
+    for (int op = 0; op < NUM_OPS; op++)
+        totalWeight += opWeights[op];
+    if (totalWeight <= 0)
+    {
+        fprintf(stderr, "The operation mix is empty.\n");
+        return 2;
+    }
+
+    for (long i = 0; i < initialOwners; i++)
+        emitNewOwner();
+
+    long emitted = 0;
+    while (emitted < numOps)
+    {
+        int pick = randomBelow(totalWeight);
+        int op = 0;
+        while (pick >= opWeights[op])
+            pick -= opWeights[op++];
+
+        if (op <= OP_DISPLAY)
+        {
+            if (ownerCount == 0)
+                continue;
+            emitOwnerSession();
+        }
+        else if (op == OP_MERGE)
+        {
+            if (!emitMerge())
+                continue;
+        }
+        else if (op == OP_SORT)
+            emitSort();
+        else if (op == OP_PRINT)
+            emitPrint();
+        else if (op == OP_DELETE)
+        {
+            if (ownerCount == 0)
+                continue;
+            emitDelete();
+        }
+        else
+            emitNewOwner();
+        emitted++;
+    }
+    printf("7\n");
+    free(owners);
+    return 0;
+}
@@ -0,0 +1,204 @@
+// End-to-end replay: feeds a stdin script through mainMenu in-process, times it and checks the output.
+//
+// Build (from the repo root):
+//   gcc -O2 -std=c99 -Wall -Wextra -Werror bench/replay.c -o ex6_replay -pthread
+// Run:
+//   ./ex6_replay SCRIPT [--golden FILE] [--record FILE] [--repeat R]
+//
+// --golden compares the program output byte for byte with FILE, --record (re)writes FILE.
+// Throughput counts menu operations: every main-menu or Pokedex-menu selection is one operation.
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define EX6_NO_MAIN
+#include "../ex6.c"
+
+static double nowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static char *readWholeFile(const char *path, size_t *length)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return NULL;
+    size_t capacity = 4096, size = 0;
+    char *data = malloc(capacity);
+    size_t got;
+    while (data && (got = fread(data + size, 1, capacity - size, file)) > 0)
+    {
+        size += got;
+        if (size == capacity)
+        {
+            capacity *= 2;
+            char *temp = realloc(data, capacity);
+            if (!temp)
+                free(data);
+            data = temp;
+        }
+    }
+    fclose(file);
+    if (data)
+        *length = size;
+    return data;
+}
+
+static long countOccurrences(const char *text, size_t length, const char *needle)
+{
+    long count = 0;
+    size_t needleLength = strlen(needle);
+    for (size_t i = 0; i + needleLength <= length; i++)
+    {
+        if (memcmp(text + i, needle, needleLength) == 0)
+        {
+            count++;
+            i += needleLength - 1;
+        }
+    }
+    return count;
+}
+
+static int compareWithGolden(FILE *report, const char *output, size_t outputLength, const char *goldenPath)
+{
+    size_t goldenLength = 0;
+    char *golden = readWholeFile(goldenPath, &goldenLength);
+    if (!golden)
+    {
+        fprintf(report, "Cannot read golden file %s\n", goldenPath);
+        return 0;
+    }
+    size_t i = 0;
+    long line = 1;
+    while (i < outputLength && i < goldenLength && output[i] == golden[i])
+    {
+        if (output[i] == '\n')
+            line++;
+        i++;
+    }
+    int same = (i == outputLength && i == goldenLength);
+    if (!same)
+        fprintf(report, "MISMATCH against %s at byte %zu (line %ld)\n", goldenPath, i, line);
+    free(golden);
+    return same;
+}
+
+static int compareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv)
+{
+    const char *scriptPath = NULL;
+    const char *goldenPath = NULL;
+    const char *recordPath = NULL;
+    int repeat = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc)
+            goldenPath = argv[++i];
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            recordPath = argv[++i];
+        else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+            repeat = atoi(argv[++i]);
+        else if (argv[i][0] != '-' && scriptPath == NULL)
+            scriptPath = argv[i];
+        else
+        {
+            fprintf(stderr, "Usage: %s SCRIPT [--golden FILE] [--record FILE] [--repeat R]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (scriptPath == NULL || repeat < 1)
+    {
+        fprintf(stderr, "Usage: %s SCRIPT [--golden FILE] [--record FILE] [--repeat R]\n", argv[0]);
+        return 2;
+    }
+
+    FILE *report = fdopen(dup(STDOUT_FILENO), "w");
+    char outputPath[] = "/tmp/ex6_replay_XXXXXX";
+    int outputFd = mkstemp(outputPath);
+    if (!report || outputFd < 0)
+    {
+        fprintf(stderr, "Cannot set up output capture.\n");
+        return 1;
+    }
+    close(outputFd);
+
+    double *runs = malloc(sizeof(double) * repeat);
+    if (!runs)
+        return 1;
+    for (int r = 0; r < repeat; r++)
+    {
+        if (!freopen(scriptPath, "r", stdin))
+        {
+            fprintf(report, "Cannot open script %s\n", scriptPath);
+            return 1;
+        }
+        if (!freopen(outputPath, "w", stdout))
+        {
+            fprintf(report, "Cannot open %s\n", outputPath);
+            return 1;
+        }
+        double t0 = nowNs();
+        mainMenu();
+        fflush(stdout);
+        runs[r] = nowNs() - t0;
+        freeAllOwners();
+    }
+    fclose(stdout);
+
+    size_t outputLength = 0;
+    char *output = readWholeFile(outputPath, &outputLength);
+    remove(outputPath);
+    if (!output)
+    {
+        fprintf(report, "Cannot read captured output.\n");
+        return 1;
+    }
+
+    long ops = countOccurrences(output, outputLength, "=== Main Menu ===") +
+               countOccurrences(output, outputLength, "'s Pokedex Menu --");
+    qsort(runs, repeat, sizeof(double), compareDoubles);
+    double best = runs[0], median = runs[repeat / 2];
+    fprintf(report, "script:      %s\n", scriptPath);
+    fprintf(report, "operations:  %ld\n", ops);
+    fprintf(report, "output:      %zu bytes\n", outputLength);
+    fprintf(report, "runs:        %d (best %.3f ms, median %.3f ms)\n", repeat, best / 1e6, median / 1e6);
+    fprintf(report, "throughput:  %.0f ops/s (best run)\n", best > 0 ? ops / (best / 1e9) : 0.0);
+
+    int status = 0;
+    if (recordPath)
+    {
+        FILE *golden = fopen(recordPath, "wb");
+        if (!golden || fwrite(output, 1, outputLength, golden) != outputLength)
+        {
+            fprintf(report, "Cannot write %s\n", recordPath);
+            status = 1;
+        }
+        else
+            fprintf(report, "recorded:    %s\n", recordPath);
+        if (golden)
+            fclose(golden);
+    }
+    if (goldenPath)
+    {
+        if (compareWithGolden(report, output, outputLength, goldenPath))
+            fprintf(report, "golden:      match (%s)\n", goldenPath);
+        else
+            status = 1;
+    }
+    free(output);
+    free(runs);
+    fclose(report);
+    return status;
+}
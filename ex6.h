@@ -1,10 +1,17 @@
 #ifndef EX6_H
 #define EX6_H
 
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L // clock_gettime for the latency histograms and the trace
+#endif
+
 #include <ctype.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 
 typedef enum
@@ -26,6 +33,11 @@ typedef enum
     ICE
 } PokemonType;
 
+#define POKEMON_TYPE_COUNT (ICE + 1)
+
+// Catalog IDs 1..151 plus the unused slot 0, for arrays indexed by ID
+#define POKEDEX_SLOTS 152
+
 typedef enum
 {
     CANNOT_EVOLVE,
@@ -43,20 +55,43 @@ typedef struct PokemonData
 } PokemonData;
 
 // Binary Tree Node (for Pokédex)
+// Pokedex trees share unchanged subtrees: refCount counts the owners and parent nodes pointing at a node,
+// and a node with refCount > 1 is copied before it is changed.
 typedef struct PokemonNode
 {
     PokemonData *data;
     struct PokemonNode *left;
     struct PokemonNode *right;
+    int refCount;
+    int size; // nodes in this subtree, for rank/select/range counts
 } PokemonNode;
 
+// Names shorter than this are stored inside the OwnerNode itself, longer ones in the name arena
+#define OWNER_INLINE_NAME 24
+
+// Running totals of an owner's Pokedex, kept current by the registry hooks so ranking owners walks no tree.
+// Scores are fight scores in tenths (see fightScoreTenths).
+typedef struct
+{
+    int count;
+    long scoreSum;
+    uint64_t strengthMask[3];   // bit r is set when the owner has the r-th strongest species, so the max is the lowest bit
+    int typeCounts[POKEMON_TYPE_COUNT];
+} OwnerAggregates;
+
 // Linked List Node (for Owners)
 typedef struct OwnerNode
 {
-    char *ownerName;          // Owner's name
+    char *ownerName;          // Owner's name: points at inlineName or into the name arena, lives as long as the node
+    unsigned int nameLength;  // strlen(ownerName)
+    unsigned int nameHash;    // FNV-1a of ownerName, checked before comparing bytes
+    char inlineName[OWNER_INLINE_NAME];
     PokemonNode *pokedexRoot; // Pointer to the root of the owner's Pokédex
     struct OwnerNode *next;   // Next owner in the linked list
     struct OwnerNode *prev;   // Previous owner in the linked list
+    int inRegistry;           // linked into the owners list, so its Pokemon are in the leaderboard
+    OwnerAggregates stats;    // count, score sum and max, type counts; zero while not in the list
+    struct FrozenPokedex *frozen; // read-optimized copy of the tree's layout, dropped on the next change (NULL if none)
 } OwnerNode;
 
 typedef struct queueNode {
@@ -70,6 +105,9 @@ typedef struct pokemonQueue
 //queue for our BFS
 {
    queueNode *front, *rear;
+#ifdef EX6_STATS
+   unsigned long long length; //current length, only tracked for the peak in the stats report
+#endif
 }pokemonQueue;
 
 queueNode* createNode(PokemonNode* pokeNode);
@@ -141,12 +179,45 @@ PokemonNode *createPokemonNode(const PokemonData *data); //done
 
 /**
  * @brief Create an OwnerNode for the circular owners list.
- * @param ownerName the dynamically allocated name
+ * @param ownerName the name, copied into the node (or the name arena), so the caller keeps its buffer
  * @param starter BST root for the starter Pokemon
  * @return newly allocated OwnerNode*
  * Why we made it: Each user is represented as an OwnerNode.
  */
-OwnerNode *createOwner(char *ownerName, PokemonNode *starter); //done
+OwnerNode *createOwner(const char *ownerName, PokemonNode *starter); //done
+
+/**
+ * @brief Store a name in an owner: inline if short, otherwise in the append-only name arena.
+ * @param owner the owner to name
+ * @param name the name bytes (need not be NUL-terminated)
+ * @param length number of bytes in name
+ * Why we made it: One allocation per owner less, and a name lifetime tied to the owner (or the arena).
+ */
+void setOwnerName(OwnerNode *owner, const char *name, size_t length);
+
+/**
+ * @brief FNV-1a hash of a name.
+ * @param name the bytes to hash
+ * @param length number of bytes
+ * @return 32-bit hash
+ * Why we made it: Cached in every OwnerNode so lookups skip most byte comparisons.
+ */
+unsigned int hashOwnerName(const char *name, size_t length);
+
+/**
+ * @brief Compare two owners by name, like strcmp on their names.
+ * @param a first owner
+ * @param b second owner
+ * @return <0, 0 or >0
+ * Why we made it: Uses the cached lengths instead of scanning for the terminator.
+ */
+int compareOwnerNames(const OwnerNode *a, const OwnerNode *b);
+
+/**
+ * @brief Release every block of the name arena.
+ * Why we made it: The arena is append-only, so it is dropped as a whole once no owner is left.
+ */
+void freeNameArena(void);
 
 /**
  * @brief Free one PokemonNode (including name).
@@ -156,12 +227,28 @@ OwnerNode *createOwner(char *ownerName, PokemonNode *starter); //done
 void freePokemonNode(PokemonNode *node);
 
 /**
- * @brief Recursively free a BST of PokemonNodes.
+ * @brief Drop one reference to a BST of PokemonNodes, freeing the nodes no other tree shares.
  * @param root BST root
- * Why we made it: Clearing a user’s entire Pokedex means freeing a tree.
+ * Why we made it: Clearing a user’s entire Pokedex means freeing a tree, but a clone may still use parts of it.
  */
 void freePokemonTree(PokemonNode *root);
 
+/**
+ * @brief Take one more reference to a BST.
+ * @param root BST root (may be NULL)
+ * @return root
+ * Why we made it: Sharing a tree (clone, snapshot) is O(1) instead of copying every node.
+ */
+PokemonNode *retainPokemonTree(PokemonNode *root);
+
+/**
+ * @brief Copy-on-write: trade one reference to node for a node only the caller points at.
+ * @param node a node the caller holds a reference to
+ * @return node itself if unshared, otherwise a copy sharing node's children
+ * Why we made it: Every change walks down through this, so only the touched path is copied.
+ */
+PokemonNode *ownPokemonNode(PokemonNode *node);
+
 /**
  * @brief Free an OwnerNode (including name and entire Pokedex BST).
  * @param owner pointer to the owner
@@ -174,13 +261,13 @@ void freeOwnerNode(OwnerNode *owner);
    ------------------------------------------------------------ */
 
 /**
- * @brief Insert a PokemonNode into BST by ID; duplicates freed.
- * @param root pointer to BST root
+ * @brief Insert a PokemonNode into BST by ID; the ID must not be in the tree yet.
+ * @param root pointer to BST root (the caller's reference is handed over)
  * @param newNode node to insert
  * @return updated BST root
- * Why we made it: Standard BST insertion ignoring duplicates.
+ * Why we made it: Standard BST insertion; shared nodes on the way down are copied.
  */
-void insertPokemonNode(PokemonNode *root, PokemonNode *newNode);
+PokemonNode *insertPokemonNode(PokemonNode *root, PokemonNode *newNode);
 
 /**
  * @brief BFS search for a Pokemon by ID in the BST.
@@ -193,13 +280,43 @@ PokemonNode *searchPokemonBFS(PokemonNode *root, int id); //done
 
 /**
  * @brief Remove node from BST by ID if found (BST removal logic).
- * @param root BST root
+ * @param root BST root (the caller's reference is handed over)
  * @param id ID to remove
  * @return updated BST root
- * Why we made it: We handle special cases of a BST remove (0,1,2 children).
+ * Why we made it: We handle special cases of a BST remove (0,1,2 children), copying only the path to the node.
  */
 PokemonNode *removeNodeBST(PokemonNode *root, int id);
 
+/**
+ * @brief Point the node with the given ID at other Pokemon data (same ordering slot).
+ * @param root BST root (the caller's reference is handed over)
+ * @param id ID of the node to change
+ * @param data new data, whose ID must keep the tree ordered
+ * @return updated BST root
+ * Why we made it: Evolving changes a node in place, which must not show through in trees sharing it.
+ */
+PokemonNode *replacePokemonData(PokemonNode *root, int id, const PokemonData *data);
+
+/**
+ * @brief Replace a tree with a perfectly balanced one holding the given Pokemon.
+ * @param oldRoot the tree being replaced (the caller's reference is handed over)
+ * @param sorted Pokemon data in strictly increasing ID order
+ * @param count number of entries in sorted (at most POKEDEX_CAPACITY)
+ * @return root of the new tree
+ * Why we made it: Bulk changes rebuild once in O(n) instead of n inserts/removals; nodes only the old
+ * tree held are reused, so an unshared tree is rebuilt without allocating.
+ */
+PokemonNode *buildBalancedPokedex(PokemonNode *oldRoot, const PokemonData **sorted, int count);
+
+/**
+ * @brief Copy a tree's Pokemon data into an array in ID order.
+ * @param root BST root
+ * @param out array with room for every node (POKEDEX_CAPACITY is always enough)
+ * @return number of entries written
+ * Why we made it: The sorted input of every bulk rebuild.
+ */
+int collectPokemonData(PokemonNode *root, const PokemonData **out);
+
 PokemonNode *findParent(PokemonNode *root, PokemonNode *child);
 
 PokemonNode *findMin(PokemonNode *root);
@@ -262,6 +379,92 @@ void postOrderGeneric(PokemonNode *root, VisitNodeFunc visit);
  */
 void printPokemonNode(PokemonNode *node);
 
+/**
+ * @brief Number of Pokemon in a subtree.
+ * @param root BST root (may be NULL)
+ * @return root's cached size, 0 for NULL
+ * Why we made it: Every tree operation keeps the sizes current, so counting is O(1).
+ */
+int pokedexSize(PokemonNode *root);
+
+/**
+ * @brief How many Pokemon have an ID smaller than id.
+ * @param root BST root
+ * @param id any ID
+ * @return the count, which is also the 0-based position of id if it is present
+ * Why we made it: Rank in O(height) from the subtree sizes.
+ */
+int pokemonRank(PokemonNode *root, int id);
+
+/**
+ * @brief The k-th Pokemon by ID.
+ * @param root BST root
+ * @param k 1-based position
+ * @return the node, or NULL if k is out of range
+ * Why we made it: Select in O(height); "the 10th Pokemon" and pages of a big Pokedex.
+ */
+PokemonNode *selectPokemon(PokemonNode *root, int k);
+
+/**
+ * @brief How many Pokemon have an ID in [low, high].
+ * @param root BST root
+ * @return the count
+ * Why we made it: Two ranks, O(height), no walk over the range.
+ */
+int countPokemonInRange(PokemonNode *root, int low, int high);
+
+/**
+ * @brief Visit the Pokemon with an ID in [low, high], in ID order.
+ * @param root BST root
+ * @param low smallest ID wanted
+ * @param high largest ID wanted
+ * @param visit called on each node in the range
+ * @return number of nodes visited
+ * Why we made it: O(height + k): subtrees outside the range are never entered.
+ */
+int visitPokemonInRange(PokemonNode *root, int low, int high, VisitNodeFunc visit);
+
+/**
+ * @brief Ask for an owner and run a range listing, range count, rank or select on their Pokedex.
+ * Why we made it: Tools-menu front end for the order-statistic queries.
+ */
+void pokedexQueryMenu(void);
+
+// Set operations between two Pokedexes, by ID
+typedef enum
+{
+    SET_INTERSECTION,        // in both
+    SET_DIFFERENCE,          // in the first only
+    SET_SYMMETRIC_DIFFERENCE // in exactly one
+} PokedexSetOp;
+
+/**
+ * @brief Visit, in ID order, every Pokemon the set operation selects from two Pokedexes.
+ * @param first first tree (for a difference, the one kept)
+ * @param second second tree
+ * @param op which operation
+ * @param visit called on each selected node (the first tree's node for an intersection)
+ * @return how many were visited
+ * Why we made it: Both trees are streamed in lockstep with explicit stacks, O(n + m) and nothing copied.
+ */
+int visitPokedexSetOp(PokemonNode *first, PokemonNode *second, PokedexSetOp op, VisitNodeFunc visit);
+
+/**
+ * @brief The same selection as a new balanced tree.
+ * @param first first tree
+ * @param second second tree
+ * @param op which operation
+ * @return the new tree (NULL if empty), owned by the caller
+ * Why we made it: Only when the caller wants to keep the result, e.g. as a new owner.
+ */
+PokemonNode *pokedexSetOp(PokemonNode *first, PokemonNode *second, PokedexSetOp op);
+
+/**
+ * @brief Ask for two owners and an operation, print the result in ID order, and optionally save it as a new owner.
+ * Why we made it: Tools-menu front end for trade planning.
+ */
+void pokedexSetOpMenu(void);
+
 /* ------------------------------------------------------------
    5) Display Methods (BFS, Pre, In, Post, Alphabetical)
    ------------------------------------------------------------ */
@@ -357,6 +560,29 @@ void pokemonFight(OwnerNode *owner);
  */
 void evolvePokemon(OwnerNode *owner);
 
+/**
+ * @brief The ID a catalog Pokemon evolves into.
+ * @param id catalog ID
+ * @return the evolved form's ID, or 0 if it does not evolve (or id is not in the catalog)
+ * Why we made it: One precomputed table instead of CAN_EVOLVE checks plus ID arithmetic at every call site.
+ */
+int evolutionOf(int id);
+
+/**
+ * @brief Evolve every eligible Pokemon of one owner by one stage, in a single in-order pass.
+ * @param owner pointer to the Owner
+ * @return number of Pokemon that evolved or were released
+ * Why we made it: evolvePokemon for the whole Pokedex at once, with the same rule: when the evolved
+ * form is already there (and stays), the unevolved one is released.
+ */
+int evolveAllPokemon(OwnerNode *owner);
+
+/**
+ * @brief Ask for an owner (or everyone) and evolve all of their eligible Pokemon.
+ * Why we made it: Tools-menu front end for evolveAllPokemon.
+ */
+void evolveAllMenu(void);
+
 /**
  * @brief Prompt for an ID, BFS-check duplicates, then insert into BST.
  * @param owner pointer to the Owner
@@ -364,6 +590,69 @@ void evolvePokemon(OwnerNode *owner);
  */
 void addPokemon(OwnerNode *owner);
 
+/**
+ * @brief Add many Pokemon at once: sort and dedup the IDs, merge them with the Pokedex in order, rebuild balanced.
+ * @param owner pointer to the Owner
+ * @param ids catalog IDs in any order, repeats allowed
+ * @param count number of entries in ids
+ * @return number of Pokemon added
+ * Why we made it: Seeding a trainer with k species costs O(n + k) and leaves a balanced tree,
+ * instead of k searches and inserts into a degenerate one. IDs already there are reported like addPokemon.
+ */
+int addPokemonBulk(OwnerNode *owner, const int *ids, int count);
+
+/**
+ * @brief Ask for an owner and a list of IDs and ranges ("1 4 10-20"), then add them in bulk.
+ * Why we made it: Tools-menu front end for addPokemonBulk.
+ */
+void bulkAddMenu(void);
+
+// A test on one Pokemon; context carries whatever the predicate needs
+typedef int (*PokemonPredicate)(const PokemonData *data, const void *context);
+
+// Conditions for bulk release, all of which must hold (ranges are inclusive)
+typedef struct
+{
+    int type;                 // a PokemonType, or -1 for any
+    int minHp, maxHp;
+    int minAttack, maxAttack;
+    int minId, maxId;
+    int canEvolve;            // 1, 0, or -1 for any
+} PokemonFilter;
+
+/**
+ * @brief A PokemonFilter that matches every Pokemon.
+ * @return the filter
+ * Why we made it: Callers only set the conditions they care about.
+ */
+PokemonFilter anyPokemonFilter(void);
+
+/**
+ * @brief PokemonPredicate over a PokemonFilter.
+ * @param data the Pokemon to test
+ * @param context a const PokemonFilter*
+ * @return 1 if every condition holds
+ * Why we made it: The predicate behind "release all BUG types" or "everything with hp < 40".
+ */
+int matchesPokemonFilter(const PokemonData *data, const void *context);
+
+/**
+ * @brief Release every Pokemon of an owner that matches a predicate, in one traversal.
+ * @param owner pointer to the Owner
+ * @param matches the predicate
+ * @param context passed to matches
+ * @return number of Pokemon released
+ * Why we made it: One in-order pass and one balanced rebuild instead of a search, parent walk
+ * and removal per Pokemon; the dropped nodes are freed together at the end.
+ */
+int releasePokemonWhere(OwnerNode *owner, PokemonPredicate matches, const void *context);
+
+/**
+ * @brief Ask for an owner (or everyone) and filter conditions, then release the matching Pokemon.
+ * Why we made it: Tools-menu front end for releasePokemonWhere.
+ */
+void bulkReleaseMenu(void);
+
 /**
  * @brief Prompt for ID, remove that Pokemon from BST by ID.
  * @param owner pointer to the Owner
@@ -383,23 +672,17 @@ void freePokemon(OwnerNode *owner);
 void displayMenu(OwnerNode *owner);
 
 /* ------------------------------------------------------------
-   8) Sorting Owners (Bubble Sort on Circular List)
+   8) Sorting Owners (Circular List)
    ------------------------------------------------------------ */
 
 /**
  * @brief Sort the circular owners list by name.
  * Why we made it: Another demonstration of pointer manipulation + sorting logic.
+ * The nodes are collected, sorted with qsort and relinked, so each owner keeps its own node
+ * (and the name stored inside it).
  */
 void sortOwners(void);
 
-/**
- * @brief Helper to swap name & pokedexRoot in two OwnerNode.
- * @param a pointer to first owner
- * @param b pointer to second owner
- * Why we made it: Used internally by bubble sort to swap data.
- */
-void swapOwnerData(OwnerNode *a, OwnerNode *b);
-
 /* ------------------------------------------------------------
    9) Circular List Linking & Searching
    ------------------------------------------------------------ */
@@ -448,15 +731,26 @@ void openPokedexMenu(void); //done
  */
 void deletePokedex();
 
-void deletePokedexByAdress(OwnerNode* owner);
-
 /**
  * @brief Merge the second owner's Pokedex into the first, then remove the second owner.
  * Why we made it: BFS copy demonstration plus removing an owner.
  */
 void mergePokedexMenu(void);
 
-void BFSMerge(PokemonNode *source, PokemonNode *dest);
+/**
+ * @brief Insert every Pokemon of source that dest lacks.
+ * @param source tree to read
+ * @param dest tree to extend (the caller's reference is handed over)
+ * @return updated dest root
+ * Why we made it: The merge itself, level by level so the result keeps source's shape where it can.
+ */
+PokemonNode *BFSMerge(PokemonNode *source, PokemonNode *dest);
+
+/**
+ * @brief Create a new owner whose Pokedex is a clone of an existing owner's.
+ * Why we made it: Templates and what-if copies; the clone shares every node until one side changes.
+ */
+void clonePokedexMenu(void);
 
 /* ------------------------------------------------------------
    11) Printing Owners in a Circle
@@ -468,6 +762,16 @@ void BFSMerge(PokemonNode *source, PokemonNode *dest);
  */
 void printOwnersCircular();
 
+/**
+ * @brief Write count lines "[i] name" stepping from the head forward or backward, exactly as printOwnersCircular does.
+ * @param out where to write
+ * @param forward 1 to follow next, 0 to follow prev
+ * @param count how many lines
+ * Why we made it: The ring is rendered once into a block, and each pass around it is the block with its counters
+ * rewritten in place, then one fwrite: the cost follows the output bytes, not a pointer chase and a printf per line.
+ */
+void writeOwnersCircular(FILE *out, int forward, int count);
+
 /* ------------------------------------------------------------
    12) Cleanup All Owners at Program End
    ------------------------------------------------------------ */
@@ -488,6 +792,820 @@ void freeAllOwners();
  */
 void mainMenu(void);
 
+/* ------------------------------------------------------------
+   14) Instrumentation (counters need -DEX6_STATS)
+   ------------------------------------------------------------ */
+
+#ifdef EX6_STATS
+typedef struct
+{
+    unsigned long long searchCalls;       // searchPokemonBFS entries from outside the recursion
+    unsigned long long searchComparisons; // nodes compared by searchPokemonBFS
+    unsigned long long removeComparisons; // nodes compared by removeNodeBST
+    unsigned long long pokemonNodeAllocs; // createPokemonNode
+    unsigned long long pathCopies;        // shared nodes copied by ownPokemonNode
+    unsigned long long queueNodeAllocs;   // createNode
+    unsigned long long ownerAllocs;       // createOwner
+    unsigned long long peakQueueLength;   // longest BFS queue seen
+    unsigned long long ownerLookups;      // findOwnerByName and by-number owner picks
+    unsigned long long ownerListHops;     // next/prev steps taken by those lookups
+} OpStats;
+
+extern OpStats opStats;
+
+#define STAT_INC(field) (opStats.field++)
+#define STAT_ADD(field, amount) (opStats.field += (amount))
+#define STAT_PEAK(field, value)          \
+    do                                   \
+    {                                    \
+        if ((value) > opStats.field)     \
+            opStats.field = (value);     \
+    } while (0)
+#else
+// compiled out: no code, no data
+#define STAT_INC(field) ((void)0)
+#define STAT_ADD(field, amount) ((void)0)
+#define STAT_PEAK(field, value) ((void)0)
+#endif
+
+/**
+ * @brief Print the operation counters (if compiled in) and every owner's tree shape.
+ * @param out stream to write to (stdout from the menu, stderr at exit)
+ * Why we made it: When a run is slow we want to see where the comparisons and allocations went.
+ */
+void printStatsReport(FILE *out);
+
+/**
+ * @brief Walk a BST and fill a histogram of node depths (root is depth 0).
+ * @param root BST root
+ * @param depth depth of root
+ * @param histogram array indexed by depth, must hold at least 151 entries
+ * @return height of the tree (number of levels, 0 for an empty tree)
+ * Why we made it: Tree height is what decides the cost of search/insert/remove in an unbalanced BST.
+ */
+int collectDepths(PokemonNode *root, int depth, int *histogram);
+
+#ifdef EX6_LATENCY
+typedef enum
+{
+    LAT_NEW_POKEDEX,
+    LAT_DELETE_POKEDEX,
+    LAT_MERGE,
+    LAT_SORT_OWNERS,
+    LAT_PRINT_CIRCULAR,
+    LAT_ADD,
+    LAT_RELEASE,
+    LAT_FIGHT,
+    LAT_EVOLVE,
+    LAT_DISPLAY_BFS,
+    LAT_DISPLAY_PRE,
+    LAT_DISPLAY_IN,
+    LAT_DISPLAY_POST,
+    LAT_DISPLAY_ALPHA,
+    LAT_NUM_OPS
+} LatencyOp;
+
+// HDR-style buckets: exact below 32ns, then 16 linear sub-buckets per power of two (~6% precision)
+#define LATENCY_BUCKETS 976
+
+typedef struct
+{
+    unsigned long long count;
+    unsigned long long totalNs;
+    unsigned long long maxNs;
+    long maxSize; // data size (Pokedex or owner count) when the max was recorded
+    unsigned long long buckets[LATENCY_BUCKETS];
+} LatencyHistogram;
+
+extern LatencyHistogram latencyHistograms[LAT_NUM_OPS];
+
+/**
+ * @brief Add one sample to an operation's histogram.
+ * @param op which operation
+ * @param ns elapsed nanoseconds
+ * @return 1 if this sample is the new max for op (so the caller records the data size), else 0
+ * Why we made it: Averages hide spikes; the histogram keeps the whole distribution.
+ */
+int recordLatency(LatencyOp op, unsigned long long ns);
+
+#define LATENCY_START() unsigned long long latencyStart = monotonicNs()
+// sizeExpr is only evaluated when the sample is a new max, so it may walk a tree
+#define LATENCY_RECORD(op, sizeExpr)                                       \
+    do                                                                     \
+    {                                                                      \
+        if (recordLatency((op), monotonicNs() - latencyStart))             \
+            latencyHistograms[(op)].maxSize = (sizeExpr);                  \
+    } while (0)
+#else
+#define LATENCY_START() ((void)0)
+#define LATENCY_RECORD(op, sizeExpr) ((void)0)
+#endif
+
+#ifdef EX6_TRACE
+/**
+ * @brief Append one trace event to the calling thread's buffer.
+ * @param name span name, must be a string literal (it is stored, not copied)
+ * @param phase 'B' to open a span, 'E' to close it
+ * Why we made it: Each thread writes only its own buffer, so tracing needs no locks.
+ */
+void traceEvent(const char *name, char phase);
+
+#define TRACE_BEGIN(name) traceEvent((name), 'B')
+#define TRACE_END(name) traceEvent((name), 'E')
+#else
+#define TRACE_BEGIN(name) ((void)0)
+#define TRACE_END(name) ((void)0)
+#endif
+
+/**
+ * @brief Write every buffered trace event as Chrome trace-event JSON (no-op without -DEX6_TRACE).
+ * Why we made it: Registered with atexit on the first event; opens in chrome://tracing or Perfetto.
+ */
+void flushTrace(void);
+
+/**
+ * @brief Monotonic clock in nanoseconds.
+ * @return nanoseconds since an arbitrary fixed point
+ * Why we made it: Shared time source for the latency histograms and the trace.
+ */
+unsigned long long monotonicNs(void);
+
+// Every allocation goes through these macros. With -DEX6_ALLOC_TRACK each one is tagged with its
+// subsystem and call site; with -DEX6_ALLOC_ASSERT as well, allocating inside a ZERO_ALLOC region aborts.
+typedef enum
+{
+    ALLOC_INPUT,   // getDynamicInput
+    ALLOC_NAMES,   // myStrdup
+    ALLOC_POKEDEX, // createPokemonNode, compact node arrays, frozen layouts
+    ALLOC_OWNERS,  // createOwner
+    ALLOC_QUEUE,   // createNode, createPokemonQueue
+    ALLOC_SORT,    // initNodeArray, addNode
+    ALLOC_TRACE,   // trace chunks
+    ALLOC_ARENA,   // name arena blocks
+    ALLOC_UNDO,    // undo/redo records
+    ALLOC_INDEX,   // leaderboard holders and hash buckets
+    ALLOC_PRINT,   // rendered blocks of the circular print
+    ALLOC_NUM_TAGS
+} AllocTag;
+
+#ifdef EX6_ALLOC_TRACK
+void *trackedMalloc(AllocTag tag, size_t size, const char *file, int line);
+void *trackedRealloc(AllocTag tag, void *ptr, size_t size, const char *file, int line);
+void trackedFree(void *ptr);
+void zeroAllocEnter(int delta);
+
+#define EX6_MALLOC(tag, size) trackedMalloc((tag), (size), __FILE__, __LINE__)
+#define EX6_REALLOC(tag, ptr, size) trackedRealloc((tag), (ptr), (size), __FILE__, __LINE__)
+#define EX6_FREE(ptr) trackedFree(ptr)
+#define ZERO_ALLOC_BEGIN() zeroAllocEnter(1)
+#define ZERO_ALLOC_END() zeroAllocEnter(-1)
+#else
+#define EX6_MALLOC(tag, size) malloc(size)
+#define EX6_REALLOC(tag, ptr, size) realloc((ptr), (size))
+#define EX6_FREE(ptr) free(ptr)
+#define ZERO_ALLOC_BEGIN() ((void)0)
+#define ZERO_ALLOC_END() ((void)0)
+#endif
+
+/**
+ * @brief Print allocations, frees, bytes, live and peak live bytes per subsystem, plus the busiest call sites.
+ * @param out stream to write to
+ * Why we made it: Allocation regressions in hot paths show up here before they show up in latency.
+ */
+void printAllocReport(FILE *out);
+
+/**
+ * @brief Print p50/p99/p999/max for every timed operation (if compiled in).
+ * @param out stream to write to
+ * Why we made it: Tail latency per operation, tied to the data size of the slowest run.
+ */
+void printLatencyReport(FILE *out);
+
+/**
+ * @brief Count the owners in the circular list.
+ * @return number of owners
+ * Why we made it: Reports need the size of the registry.
+ */
+int countOwners(void);
+
+/**
+ * @brief Hidden main-menu option (8): diagnostics and bulk tools that are not part of the regular menus.
+ * Why we made it: Keep the regular menus (and every existing script) unchanged.
+ */
+void toolsMenu(void);
+
+/* ------------------------------------------------------------
+   15) Undo / Redo
+   ------------------------------------------------------------ */
+
+// Each record keeps the owner's tree root from before and after the change. The trees share
+// every node the change did not touch, so a record costs about one path of nodes.
+typedef enum
+{
+    UNDO_ADD,
+    UNDO_RELEASE,
+    UNDO_EVOLVE,
+    UNDO_MERGE,
+    UNDO_DELETE,
+    UNDO_EVOLVE_ALL,
+    UNDO_ADD_MANY,
+    UNDO_RELEASE_MANY,
+    UNDO_BATCH
+} UndoKind;
+
+typedef struct UndoRecord
+{
+    UndoKind kind;
+    OwnerNode *owner;        // owner whose Pokedex changed (NULL for a delete)
+    PokemonNode *before;     // owner's root before the change (a held reference)
+    PokemonNode *after;      // owner's root after the change (a held reference)
+    const PokemonData *data; // the Pokemon added, released or evolved (NULL for a bulk change)
+    OwnerNode *removed;      // merge/delete: the owner taken out of the list, kept alive while undoable
+    int position;            // where removed sat in the list
+    size_t bytes;            // estimate of the memory this record keeps alive
+    unsigned long group;     // records of one bulk action share a nonzero group and are undone together
+    struct UndoRecord *newer;
+    struct UndoRecord *older;
+} UndoRecord;
+
+// Default cap for all records together; override with the EX6_UNDO_BUDGET environment variable (0 disables undo)
+#define UNDO_DEFAULT_BUDGET (1024 * 1024)
+
+/**
+ * @brief Record a change to one owner's Pokedex (add, release, evolve).
+ * @param kind what happened
+ * @param owner the owner whose root changed; its current root is taken as the after state
+ * @param data the Pokemon involved, for messages and the size estimate (NULL: the whole tree changed)
+ * @param before the root before the change; the record takes over this reference
+ * Why we made it: The before root is all undo needs, and it is shared with the new tree.
+ */
+void recordPokedexChange(UndoKind kind, OwnerNode *owner, const PokemonData *data, PokemonNode *before);
+
+/**
+ * @brief Record an owner leaving the list (merge or delete); the record keeps the owner until it is dropped.
+ * @param kind UNDO_MERGE or UNDO_DELETE
+ * @param owner merge: the owner that received the Pokemon; delete: NULL
+ * @param removed the owner already unlinked from the list
+ * @param position index removed had in the list
+ * @param before merge: owner's root before the merge (reference taken over); delete: NULL
+ * Why we made it: Undoing a delete or a merge needs the whole removed owner back.
+ */
+void recordOwnerRemoval(UndoKind kind, OwnerNode *owner, OwnerNode *removed, int position, PokemonNode *before);
+
+/**
+ * @brief Start a bulk action: until endUndoGroup, every record joins one group.
+ * Why we made it: An action over many owners is undone and redone as one step.
+ */
+void beginUndoGroup(void);
+
+/**
+ * @brief End the group started by beginUndoGroup.
+ */
+void endUndoGroup(void);
+
+/**
+ * @brief Undo the latest change, of anyone or of one owner.
+ * @param owner NULL for the latest change overall (a whole group), otherwise the latest change involving owner
+ * @return 1 if something was undone
+ * Why we made it: Mistaken releases and merges without replaying the session. A deleted or merged-away owner
+ * whose name was taken again cannot come back; that change is dropped from the history (with the owner's older
+ * records) and the next one is undone instead, so the history never gets stuck.
+ */
+int undoLastChange(OwnerNode *owner);
+
+/**
+ * @brief Redo the latest undone change, of anyone or of one owner.
+ * @param owner NULL for the latest undone change overall, otherwise the latest involving owner
+ * @return 1 if something was redone
+ * Why we made it: Undo's other half; any new change clears what can be redone.
+ */
+int redoLastChange(OwnerNode *owner);
+
+/**
+ * @brief Index of a linked owner in the circular list, counting from ownerHead.
+ * @param owner an owner in the list
+ * @return 0-based position
+ * Why we made it: A removed owner is put back where it was when its removal is undone.
+ */
+int ownerPosition(OwnerNode *owner);
+
+/**
+ * @brief Drop every undo and redo record, freeing the owners only they still hold.
+ * Why we made it: Needed before freeing the owners at exit.
+ */
+void clearUndoHistory(void);
+
+/* ------------------------------------------------------------
+   16) Registry Indexes (strongest-Pokemon leaderboard)
+   ------------------------------------------------------------ */
+
+// Every (owner, Pokemon) pair of a linked owner is indexed under its species; species are ranked once by
+// fight score, so the top K pairs are read off the strongest species' holder lists.
+typedef struct
+{
+    OwnerNode *owner;
+    const PokemonData *data;
+} LeaderboardEntry;
+
+/**
+ * @brief The pokemonFight score, in tenths so it is an exact integer.
+ * @param data the Pokemon
+ * @return attack*15 + hp*12 (ten times attack*1.5 + hp*1.2)
+ * Why we made it: Ranking needs exact comparisons; the float formula rounds.
+ */
+int fightScoreTenths(const PokemonData *data);
+
+/**
+ * @brief Note that a linked owner gained one Pokemon (no-op for owners outside the list).
+ * @param owner the owner
+ * @param data the Pokemon
+ * Why we made it: Every single-Pokemon mutation reports here, so the indexes stay current in O(1).
+ */
+void trackPokemonAdded(OwnerNode *owner, const PokemonData *data);
+
+/**
+ * @brief Note that a linked owner lost one Pokemon (no-op for owners outside the list).
+ * @param owner the owner
+ * @param data the Pokemon
+ */
+void trackPokemonRemoved(OwnerNode *owner, const PokemonData *data);
+
+/**
+ * @brief Note that a linked owner's tree went from oldRoot to newRoot.
+ * @param owner the owner
+ * @param oldRoot tree before
+ * @param newRoot tree after
+ * Why we made it: Bulk changes, merges and undo/redo report the difference in one lockstep pass.
+ */
+void trackPokedexChange(OwnerNode *owner, PokemonNode *oldRoot, PokemonNode *newRoot);
+
+/**
+ * @brief Drop everything the indexes hold.
+ * Why we made it: Called when every owner is freed at once.
+ */
+void resetRegistryIndexes(void);
+
+/**
+ * @brief The K strongest (owner, Pokemon) pairs across all owners.
+ * @param out room for k entries
+ * @param k how many
+ * @return entries written (fewer if the registry holds fewer Pokemon)
+ * Why we made it: O(K) per query instead of scoring every node of every owner.
+ */
+int topPokemon(LeaderboardEntry *out, int k);
+
+// What rankOwners orders by, strongest first
+typedef enum
+{
+    RANK_BY_COUNT,
+    RANK_BY_TOTAL,
+    RANK_BY_AVERAGE,
+    RANK_BY_STRONGEST,
+    RANK_BY_TYPE
+} OwnerRankKey;
+
+/**
+ * @brief The fight score (in tenths) of an owner's strongest Pokemon, from its cached aggregates.
+ * @param owner the owner
+ * @return the score, or 0 for an empty Pokedex
+ * Why we made it: The strength mask makes the max O(1) even after the strongest one is released.
+ */
+int strongestScoreTenths(const OwnerNode *owner);
+
+/**
+ * @brief Every owner in the list, ordered by a cached aggregate (ties by name).
+ * @param out room for countOwners() owners
+ * @param key what to order by
+ * @param type the type counted for RANK_BY_TYPE
+ * @return owners written
+ * Why we made it: Ranking reads OwnerNode::stats only, O(m log m) for m owners and no tree walks.
+ */
+int rankOwners(OwnerNode **out, OwnerRankKey key, PokemonType type);
+
+/**
+ * @brief Ask for a ranking key and print the owner power ranking.
+ * Why we made it: Tools-menu front end for rankOwners.
+ */
+void ownerRankingMenu(void);
+
+/**
+ * @brief Ask for K and print the leaderboard.
+ * Why we made it: Tools-menu front end for topPokemon.
+ */
+void leaderboardMenu(void);
+
+/* ------------------------------------------------------------
+   17) Owner Similarity (Jaccard over species sets)
+   ------------------------------------------------------------ */
+
+// The species an owner holds, one bit each. Any fixed bit order works for Jaccard;
+// OwnerAggregates::strengthMask is already one, kept current for every owner in the list.
+typedef struct
+{
+    uint64_t bits[3];
+} SpeciesSet;
+
+typedef struct
+{
+    int other;        // index of the neighbour in the input array, -1 if there are fewer than k others
+    float similarity; // |A and B| / |A or B|, 0 when both are empty
+} SimilarityNeighbor;
+
+/**
+ * @brief Jaccard similarity of two species sets.
+ * @param a first set
+ * @param b second set
+ * @return similarity in [0, 1]
+ * Why we made it: Three words of AND and popcount instead of walking two trees.
+ */
+float speciesJaccard(const SpeciesSet *a, const SpeciesSet *b);
+
+/**
+ * @brief The k most similar other sets for every set, computed by a pool of threads over tiles of rows.
+ * @param sets n species sets
+ * @param n how many
+ * @param k neighbours per set, at most 256
+ * @param threads worker threads (at least 1)
+ * @param out n*k entries, row i holds set i's neighbours from the most similar down (ties by index)
+ * @return 0, or -1 if k is too big or not every thread could be started (the rows are still all done)
+ * Why we made it: All pairs of 100k owners is 10^10 popcount kernels; tiles keep a row's work on one core.
+ */
+int similarityTopK(const SpeciesSet *sets, int n, int k, int threads, SimilarityNeighbor *out);
+
+/**
+ * @brief Stream the full n*n similarity matrix as CSV, one row per set, computed in blocks of rows by one thread pool kept for every block.
+ * @param file where to write
+ * @param sets n species sets
+ * @param names row labels
+ * @param n how many
+ * @param threads worker threads (at least 1)
+ * @return 0, or -1 on a thread or write error
+ * Why we made it: The whole matrix does not fit in memory for many owners, so only one block is held at a time.
+ */
+int writeSimilarityMatrix(FILE *file, const SpeciesSet *sets, const char *const *names, int n, int threads);
+
+/**
+ * @brief Ask for k, a thread count and a file, and write every owner's nearest neighbours (or the full matrix) there.
+ * Why we made it: Tools-menu front end for matchmaking.
+ */
+void ownerSimilarityMenu(void);
+
+/* ------------------------------------------------------------
+   18) Compact Pokedex (index-based nodes in one array)
+   ------------------------------------------------------------ */
+
+// A Pokedex never holds more than 151 species, so a node is a species ID and two 8-bit child indices:
+// 3 bytes instead of a separately allocated PokemonNode. Released slots go on a free list through `left`.
+#define COMPACT_NIL 0xFF
+
+typedef struct
+{
+    uint8_t species; // catalog ID, pokedex[species-1]
+    uint8_t left;    // index into the owner's array, or COMPACT_NIL
+    uint8_t right;
+} CompactNode;
+
+typedef struct
+{
+    CompactNode *nodes; // one contiguous array per Pokedex, grown by doubling up to 151 slots
+    uint8_t root;
+    uint8_t freeHead;   // first released slot, or COMPACT_NIL
+    uint8_t used;       // slots handed out so far (live or on the free list)
+    uint8_t capacity;
+    int count;          // live Pokemon
+} CompactPokedex;
+
+typedef void (*CompactVisitFunc)(const PokemonData *);
+
+/**
+ * @brief An empty compact Pokedex (allocates nothing until the first insert).
+ * @param dex to initialize
+ */
+void compactInit(CompactPokedex *dex);
+
+/**
+ * @brief Free the node array.
+ * @param dex to clear
+ */
+void compactFree(CompactPokedex *dex);
+
+/**
+ * @brief Insert a species, BST-ordered by ID like insertPokemonNode.
+ * @param dex the Pokedex
+ * @param id catalog ID (1-151)
+ * @return 1 if added, 0 if already there or the ID is invalid
+ */
+int compactInsert(CompactPokedex *dex, int id);
+
+/**
+ * @brief Remove a species, its slot goes on the free list.
+ * @param dex the Pokedex
+ * @param id catalog ID
+ * @return 1 if removed, 0 if it was not there
+ */
+int compactRemove(CompactPokedex *dex, int id);
+
+/**
+ * @brief Whether a species is in the Pokedex.
+ * @param dex the Pokedex
+ * @param id catalog ID
+ * @return 1 or 0
+ */
+int compactContains(const CompactPokedex *dex, int id);
+
+/**
+ * @brief Visit every Pokemon in ID order.
+ * @param dex the Pokedex
+ * @param visit called with each Pokemon's catalog data
+ */
+void compactInOrder(const CompactPokedex *dex, CompactVisitFunc visit);
+
+/**
+ * @brief Copy a pointer tree into a compact Pokedex, balanced.
+ * @param root the tree
+ * @param dex receives the copy (its old contents are freed)
+ * Why we made it: Cold Pokedexes can be parked at 3 bytes per Pokemon.
+ */
+void compactFromTree(PokemonNode *root, CompactPokedex *dex);
+
+/**
+ * @brief Build a balanced pointer tree from a compact Pokedex.
+ * @param dex the Pokedex
+ * @return the new tree, owned by the caller
+ * Why we made it: The menus, undo and sharing all work on pointer trees.
+ */
+PokemonNode *compactToTree(const CompactPokedex *dex);
+
+/* ------------------------------------------------------------
+   19) Frozen Pokedex (Eytzinger layout for lookups)
+   ------------------------------------------------------------ */
+
+// The IDs of a Pokedex in BFS order of a complete tree: the children of slot k are 2k and 2k+1.
+// nodes[k] points at the owner's own node with keys[k]; the owner's tree keeps its shape.
+typedef struct FrozenPokedex
+{
+    int count;
+    int complete; // the owner's tree has that complete shape, so nodes[1..count] is also its BFS order
+    uint8_t keys[POKEDEX_SLOTS];          // keys[1..count], 152 bytes: the whole search path is three cache lines
+    PokemonNode *nodes[POKEDEX_SLOTS];
+} FrozenPokedex;
+
+/**
+ * @brief Lay an owner's IDs out in BFS order of a complete tree, beside the unchanged tree, for branchless lookups.
+ * @param owner the owner (already frozen is a no-op)
+ * BFS display reads the array instead of the tree only when the tree already has the complete shape, which is rare
+ * for a tree built one Pokemon at a time; otherwise it walks the tree as usual.
+ * Why we made it: Pokedexes that are mostly searched (fights, evolve checks, duplicate checks) skip the pointer chase.
+ */
+void freezePokedex(OwnerNode *owner);
+
+/**
+ * @brief Drop an owner's frozen layout; the tree itself is always current, so nothing is rebuilt.
+ * @param owner the owner
+ * Why we made it: Every change reports through the registry hooks, which thaw first.
+ */
+void thawPokedex(OwnerNode *owner);
+
+/**
+ * @brief Find a Pokemon by ID in an owner's Pokedex, through the frozen layout when there is one.
+ * @param owner the owner
+ * @param id catalog ID
+ * @return the tree node, or NULL
+ */
+PokemonNode *findPokemon(OwnerNode *owner, int id);
+
+/**
+ * @brief Ask for an owner and freeze their Pokedex.
+ * Why we made it: Tools-menu front end for freezePokedex.
+ */
+void freezePokedexMenu(void);
+
+/* ------------------------------------------------------------
+   20) Export (JSON Lines / CSV)
+   ------------------------------------------------------------ */
+
+typedef enum
+{
+    EXPORT_JSONL, // {"owner":"Ash","id":1,"name":"Bulbasaur","type":"GRASS","hp":45,"attack":49,"canEvolve":true}
+    EXPORT_CSV    // owner,id,name,type,hp,attack,can_evolve (with a header row)
+} ExportFormat;
+
+/**
+ * @brief Write one row per Pokemon of every owner, owners in list order and each Pokedex in ID order.
+ * @param file where to write
+ * @param format JSON Lines or CSV
+ * @return rows written, or -1 if a write failed
+ * Why we made it: Analytics read this instead of scraping the display output. One pass over the owners,
+ * a fixed 64 KiB buffer, and the per-species part of each row is rendered once, so nothing is allocated per row.
+ */
+long exportRegistry(FILE *file, ExportFormat format);
+
+/**
+ * @brief Ask for a format and a file and export every Pokedex there.
+ * Why we made it: Tools-menu front end for exportRegistry.
+ */
+void exportMenu(void);
+
+/* ------------------------------------------------------------
+   21) Import (CSV of owner,id,id,...)
+   ------------------------------------------------------------ */
+
+/**
+ * @brief Load owners from a CSV file, one per line: the owner's name (quoted if it has commas), then species IDs.
+ * @param path the file
+ * @param threads parser threads (at least 1)
+ * @return owners added, or -1 if the file cannot be read
+ * Why we made it: Loading a trainer base through the menus is one prompt per Pokemon. Here the file is split into
+ * chunks parsed in parallel, each Pokedex is built balanced from its ID set, and the new owners are spliced into the
+ * list in one step. Duplicate owners, bad lines and invalid IDs are reported and skipped.
+ */
+int importRegistry(const char *path, int threads);
+
+/**
+ * @brief Ask for a file and a thread count and import it.
+ * Why we made it: Tools-menu front end for importRegistry.
+ */
+void importMenu(void);
+
+/* ------------------------------------------------------------
+   22) Battle simulation (type chart, rounds, Monte Carlo)
+   ------------------------------------------------------------ */
+
+#define BATTLE_MAX_ROUNDS 100
+#define BATTLE_CHUNK 65536 // battles per RNG stream, so results do not depend on the thread count
+
+typedef struct
+{
+    uint64_t state;
+} BattleRng;
+
+typedef enum
+{
+    BATTLE_FIRST_WINS,
+    BATTLE_SECOND_WINS,
+    BATTLE_DRAW
+} BattleOutcome;
+
+typedef struct
+{
+    long firstWins;
+    long secondWins;
+    long draws;
+    long rounds; // summed over all battles
+} BattleOdds;
+
+/**
+ * @brief Damage multiplier of an attack of one type on a defender of another, in quarters (0, 2, 4 or 8).
+ * @param attacker attacking type
+ * @param defender defending type
+ * @return 4 for neutral, 8 super effective, 2 not very effective, 0 no effect
+ * Why we made it: pokemonFight compares attack and HP only. The battle engine needs the type matchup, and
+ * quarters keep the damage formula in integers.
+ */
+int typeEffectiveness(PokemonType attacker, PokemonType defender);
+
+/**
+ * @brief Seed a battle RNG (splitmix64 of the seed, never zero).
+ * @param rng the generator
+ * @param seed any value
+ */
+void battleRngSeed(BattleRng *rng, uint64_t seed);
+
+/**
+ * @brief Fight two species to the end: each round both attack in random order for attack * type multiplier * a
+ * 85-100% roll, until one has no HP left or BATTLE_MAX_ROUNDS pass (a draw).
+ * @param first first species
+ * @param second second species
+ * @param rng the generator, advanced
+ * @param rounds out, rounds fought (may be NULL)
+ * @return the outcome
+ * Why we made it: a single battle with types, HP depletion and chance, reproducible from the seed.
+ */
+BattleOutcome simulateBattle(const PokemonData *first, const PokemonData *second, BattleRng *rng, int *rounds);
+
+/**
+ * @brief Run many battles between two species on a thread pool and count the outcomes.
+ * @param first first species
+ * @param second second species
+ * @param battles how many
+ * @param seed seed of the run; chunk c of BATTLE_CHUNK battles uses its own stream seeded from (seed, c)
+ * @param threads worker threads (the caller is one of them)
+ * @param out counts
+ * @return 0, or -1 if some threads could not be started (the counts are still complete)
+ * Why we made it: Event balancing needs win probabilities, not one verdict. Each chunk has its own RNG and
+ * its own counters, so threads share nothing but the next-chunk counter, and the same seed gives the same
+ * counts on any number of threads.
+ */
+int battleOdds(const PokemonData *first, const PokemonData *second, long battles, uint64_t seed, int threads,
+               BattleOdds *out);
+
+/**
+ * @brief Ask for two species, a battle count, threads and a seed, and print the win probabilities.
+ * Why we made it: Tools-menu front end for battleOdds.
+ */
+void battleSimMenu(void);
+
+/* ------------------------------------------------------------
+   23) Lineup optimizer (two owners, one-to-one matchups)
+   ------------------------------------------------------------ */
+
+typedef struct
+{
+    const PokemonData *mine;   // from the first owner
+    const PokemonData *theirs; // from the second owner
+    long wins;                 // battles the first owner's Pokemon won, out of battlesPerPair
+} LineupPair;
+
+/**
+ * @brief Pair the first owner's Pokemon with the second owner's, one-to-one, so that the first owner's expected
+ * wins are as high as possible.
+ * @param first owner we optimize for
+ * @param second opponent
+ * @param battlesPerPair simulated battles behind each matchup score
+ * @param seed seed of the simulation; a species pair always uses the same stream, whatever the teams
+ * @param threads threads filling the score matrix
+ * @param out room for POKEDEX_CAPACITY pairs, ordered by the first owner's IDs
+ * @return pairs written, the smaller team's size (the rest of the larger team sits out)
+ * Why we made it: Picking team matchups by hand with repeated fights is slow and rarely optimal. The score of
+ * every matchup is simulated once with the battle engine (rows shared out across threads), and the Hungarian
+ * algorithm then finds the best assignment in O(n^3) on integer win counts, which is instant for 151 vs 151.
+ */
+int optimizeLineup(const OwnerNode *first, const OwnerNode *second, long battlesPerPair, uint64_t seed, int threads,
+                   LineupPair *out);
+
+/**
+ * @brief Ask for two owners and the simulation settings, and print the best lineup with each pair's odds.
+ * Why we made it: Tools-menu front end for optimizeLineup.
+ */
+void lineupMenu(void);
+
+/* ------------------------------------------------------------
+   24) Command batches (all or nothing, one pass per owner)
+   ------------------------------------------------------------ */
+
+typedef enum
+{
+    BATCH_ADD,
+    BATCH_RELEASE,
+    BATCH_EVOLVE,
+    BATCH_FIGHT
+} BatchOpKind;
+
+typedef struct
+{
+    BatchOpKind kind;
+    OwnerNode *owner;
+    int id;
+    int otherId; // fight: the second Pokemon
+    int order;   // position in the batch, 0-based
+} BatchOp;
+
+typedef struct
+{
+    BatchOp *ops;
+    int count;
+    int capacity;
+} CommandBatch;
+
+/**
+ * @brief Start an empty batch.
+ * @param batch the batch
+ */
+void batchInit(CommandBatch *batch);
+
+/**
+ * @brief Queue one operation. Nothing is checked or changed until batchCommit.
+ * @param batch the batch
+ * @param owner resolved once by the caller, however many operations it gets
+ * @param kind add, release, evolve or fight
+ * @param id the Pokemon (the first one for a fight)
+ * @param otherId the second Pokemon of a fight, ignored otherwise
+ */
+void batchQueue(CommandBatch *batch, OwnerNode *owner, BatchOpKind kind, int id, int otherId);
+
+/**
+ * @brief Check every operation, then apply them all, or none if one fails.
+ * @param batch the batch, emptied afterwards either way
+ * @return operations applied, or -1 if the batch was rejected (the failing operation is printed)
+ * Why we made it: Scripted sessions spread one owner's operations through the input, and each one looks the owner
+ * up again and walks a cold tree. A batch groups them by owner and replays each owner's operations in order on a
+ * 151-bit species set, which both validates them and gives the final Pokedex. Only when all pass does each changed
+ * Pokedex get rebuilt, once, in ID order, and the whole batch is one undo step.
+ */
+int batchCommit(CommandBatch *batch);
+
+/**
+ * @brief Drop the queued operations and the batch's memory.
+ * @param batch the batch
+ */
+void batchFree(CommandBatch *batch);
+
+/**
+ * @brief Read operations per owner ("add 25", "release 4", "evolve 1", "fight 4 7") and commit them as one batch.
+ * Why we made it: Tools-menu front end for the batch functions.
+ */
+void batchMenu(void);
+
 // Array of Pokemon data
 static const PokemonData pokedex[] = {
     {1, "Bulbasaur", GRASS, 45, 49, CAN_EVOLVE},